@@ -64,16 +64,41 @@ void free_buffer(struct audio_buffer *buf)
  *  @return {float}                -- the mean square error.
  */
 float compare_audio_buffers(struct audio_buffer *a, struct audio_buffer *b)
+{
+  if (a->length != b->length) {
+    fprintf(stderr, "Audio buffers are of different lengths.\n");
+    return NAN;
+  }
+
+  return compare_audio_buffer_regions(a, 0, b, 0, a->length);
+}
+
+/*
+ *  compare_audio_buffer_regions() -- calculates the mean square error between
+ *  `length' frames of buffer `a', starting at frame `a_start', and as many
+ *  frames of buffer `b', starting at frame `b_start'; regions reaching past
+ *  the end of either buffer result in NAN;
+ *  @arg {struct audio_buffer *} a -- first audio buffer to compare;
+ *  @arg {unsigned int} a_start    -- first frame of the region in `a';
+ *  @arg {struct audio_buffer *} b -- second audio buffer to compare;
+ *  @arg {unsigned int} b_start    -- first frame of the region in `b';
+ *  @arg {unsigned int} length     -- number of frames to compare;
+ *  @return {float}                -- the mean square error.
+ */
+float compare_audio_buffer_regions(struct audio_buffer *a, unsigned int a_start,
+                                   struct audio_buffer *b, unsigned int b_start,
+                                   unsigned int length)
 {
   unsigned int i;
   float mse = 0.0f;
 
-  if (a->length != b->length) {
-    fprintf(stderr, "Audio buffers are of different lengths.\n");
+  if (a_start + length > a->length ||
+      b_start + length > b->length) {
+    fprintf(stderr, "Audio buffer region out of bounds.\n");
     return NAN;
   }
 
-  for (i = 0; i < a->length; i++) {
+  for (i = 0; i < length; i++) {
     /*if (a->data[i] > 1.0f ||
         a->data[i] < -1.0f) {
       printf("wat <%p>@%i\n", (void *)a, i);
@@ -83,10 +108,11 @@ float compare_audio_buffers(struct audio_buffer *a, struct audio_buffer *b)
       printf("wat <%p>@%i\n", (void *)b, i);
     }*/
 
-    mse += (a->data[i] - b->data[i]) * (a->data[i] - b->data[i]);
+    mse += (a->data[a_start + i] - b->data[b_start + i]) *
+           (a->data[a_start + i] - b->data[b_start + i]);
   }
 
-  mse = mse / (float)a->length;
+  mse = mse / (float)length;
 
   return mse;
 }
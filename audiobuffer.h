@@ -36,3 +36,7 @@ void free_buffer(struct audio_buffer *buf);
 
 float compare_audio_buffers(struct audio_buffer *a, struct audio_buffer *b);
 
+float compare_audio_buffer_regions(struct audio_buffer *a, unsigned int a_start,
+                                   struct audio_buffer *b, unsigned int b_start,
+                                   unsigned int length);
+
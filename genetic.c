@@ -25,12 +25,22 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <math.h>
 
 #include "audiobuffer.h"
 #include "genetic.h"
 #include "speech.h"
+#include "spectrum.h"
+#include "surrogate.h"
 #include "synth.h"
 
+unsigned long fitness_evaluation_count = 0;
+unsigned long rejected_phenotype_count = 0;
+unsigned long synthesized_frame_count = 0;
+
+enum fitness_mode fitness_mode = FITNESS_FULL;
+int surrogate_screening = 0;
+
 /*
  *  alloc_phenotype() -- allocates a phenotype structure and fills it with
  *  default data;
@@ -59,22 +69,55 @@ void free_phenotype(struct phenotype *p)
   free(p);
 }
 
+/*
+ *  copy_phenotype() -- allocates a new phenotype structure holding the same
+ *  chromosomes and fitness as a given phenotype;
+ *  @arg {struct phenotype *} p  -- the phenotype to be copied;
+ *  @return {struct phenotype *} -- the allocated copy.
+ */
+struct phenotype *copy_phenotype(struct phenotype *p)
+{
+  unsigned int i;
+  struct phenotype *copy = alloc_phenotype();
+
+  for (i = 0; i < PHENOTYPE_CHROMOSOME_COUNT; i++) {
+    copy->coefficient[i] = p->coefficient[i];
+  }
+
+  copy->fitness = p->fitness;
+
+  return copy;
+}
+
 /*
  *  calculate_phenotype_fitness() -- calculates the fitness of a given phenotype
  *  by synthesizing a signal, passing it through a filter whose coefficients are
  *  taken from the phenotype's genes, and then calculating the mean square error
- *  between the reference buffer and the synthesized buffer;
+ *  between the reference buffer and the synthesized buffer; phenotypes whose
+ *  filter is unstable are given `PHENOTYPE_PENALTY_FITNESS' without
+ *  synthesizing anything;
  *  @arg {struct phenotype *} p -- the phenotype in question;
  *  @return {float}             -- the phenotype's fitness.
  */
 float calculate_phenotype_fitness(struct phenotype *p)
 {
   float fitness = 0.0f;
-  struct audio_buffer *buf = generate_base_speech_signal(p->coefficient[0], SAMPLE_RATE);
+  struct audio_buffer *buf;
+
+  if (!phenotype_filter_is_stable(p)) {
+    return PHENOTYPE_PENALTY_FITNESS;
+  }
+
+  buf = generate_base_speech_signal(p->coefficient[0], SAMPLE_RATE);
 
   process_filter_from_phenotype(p, buf, 0, SAMPLE_RATE);
   fitness = compare_audio_buffers(buf, reference_buffer);
 
+#ifdef _OPENMP
+#pragma omp atomic
+#endif
+  synthesized_frame_count += buf->length;
+
   free_buffer(buf);
   return fitness;
 }
@@ -82,7 +125,13 @@ float calculate_phenotype_fitness(struct phenotype *p)
 /*
  *  fill_population_fitness() -- traverses an entire population of phenotypes
  *  and calculates each individual's fitness, filling it in its respective
- *  field;
+ *  field; the fitness is the spectral distance computed by
+ *  `calculate_phenotype_spectral_fitness' when `fitness_mode' is
+ *  FITNESS_SPECTRAL, and the full-length mean square error computed by
+ *  `calculate_phenotype_fitness' otherwise; individuals are independent of
+ *  each other, so the batch is spread over all available threads when built
+ *  with OpenMP; individuals rejected as unstable are added to
+ *  `rejected_phenotype_count', and the rest to `fitness_evaluation_count';
  *  @arg {struct phenotype **} population -- the array of individuals;
  *  @arg {unsigned int} population_count  -- number of individuals in array;
  *  @return {void}.
@@ -91,10 +140,257 @@ void fill_population_fitness(struct phenotype **population,
                              unsigned int population_count)
 {
   unsigned int i;
+  unsigned int rejected = 0;
+
+#ifdef _OPENMP
+#pragma omp parallel reduction(+:rejected)
+#endif
+  {
+    apply_denormal_mode();
+
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+    for (i = 0; i < population_count; i++) {
+      if (fitness_mode == FITNESS_SPECTRAL) {
+        population[i]->fitness =
+          calculate_phenotype_spectral_fitness(population[i]);
+      } else {
+        population[i]->fitness = calculate_phenotype_fitness(population[i]);
+      }
+
+      if (population[i]->fitness == PHENOTYPE_PENALTY_FITNESS) {
+        rejected++;
+      }
+    }
+  }
+
+  fitness_evaluation_count += population_count - rejected;
+  rejected_phenotype_count += rejected;
+}
+
+/*
+ *  choose_fitness_windows() -- picks `window_count' random, uniformly
+ *  distributed windows of the reference buffer; all individuals scored within
+ *  a generation must share the same windows for their fitness to be
+ *  comparable;
+ *  @arg {struct fitness_windows *} windows -- the structure to be filled;
+ *  @arg {unsigned int} window_count        -- number of windows to pick, at
+ *                                             most FITNESS_MAX_WINDOWS;
+ *  @return {void}.
+ */
+void choose_fitness_windows(struct fitness_windows *windows,
+                            unsigned int window_count)
+{
+  unsigned int i;
 
-  for (i = 0; i < population_count; i++) {
-    population[i]->fitness = calculate_phenotype_fitness(population[i]);
+  windows->count = window_count;
+
+  for (i = 0; i < window_count; i++) {
+    windows->start[i] = rand() %
+      (reference_buffer->length - FITNESS_WINDOW_LENGTH + 1);
+  }
+}
+
+/*
+ *  generate_settled_segment() -- synthesizes `frame_count' frames of a
+ *  phenotype's output, starting at frame `first_frame', preceded by up to
+ *  `settling_frames' frames for the filter to settle (fewer near the start of
+ *  the signal, where the full-length synthesis has not settled either); the
+ *  requested frames start at index `*warmup' of the returned buffer, which is
+ *  allocated here; this function is only used internally by the windowed and
+ *  spectral fitness functions;
+ *  @arg {struct phenotype *} p          -- the phenotype in question;
+ *  @arg {unsigned int} first_frame      -- index of the first requested frame;
+ *  @arg {unsigned int} frame_count      -- number of requested frames;
+ *  @arg {unsigned int} settling_frames  -- number of frames the filter needs
+ *                                          to settle;
+ *  @arg {unsigned int *} warmup         -- receives the number of frames
+ *                                          synthesized before `first_frame';
+ *  @return {struct audio_buffer *}      -- the synthesized buffer.
+ */
+static struct audio_buffer *generate_settled_segment(struct phenotype *p,
+  unsigned int first_frame, unsigned int frame_count,
+  unsigned int settling_frames, unsigned int *warmup)
+{
+  struct audio_buffer *buf;
+
+  *warmup = (first_frame < settling_frames) ? first_frame : settling_frames;
+
+  buf = generate_base_speech_segment(p->coefficient[0], first_frame - *warmup,
+                                     *warmup + frame_count);
+  process_filter_from_phenotype(p, buf, 0, buf->length);
+
+  return buf;
+}
+
+/*
+ *  calculate_phenotype_window_fitness() -- estimates the fitness of a given
+ *  phenotype from the mean square error over a few windows of the reference
+ *  buffer; every window is synthesized along with enough frames before it for
+ *  the filter's initial state to decay below FITNESS_WARMUP_TOLERANCE, so
+ *  that its output matches what a full-length synthesis would produce there
+ *  up to that tolerance; the warm-up is not capped, so poles close to the unit
+ *  circle may need to synthesize from the start of the signal; unstable
+ *  phenotypes are handled as in `calculate_phenotype_fitness';
+ *  @arg {struct phenotype *} p             -- the phenotype in question;
+ *  @arg {struct fitness_windows *} windows -- the windows to compare;
+ *  @return {float}                         -- the phenotype's fitness.
+ */
+float calculate_phenotype_window_fitness(struct phenotype *p,
+                                         struct fitness_windows *windows)
+{
+  unsigned int i;
+  unsigned int warmup, settling_frames, frame_count = 0;
+  float fitness = 0.0f;
+  struct audio_buffer *buf;
+
+  if (!phenotype_filter_is_stable(p)) {
+    return PHENOTYPE_PENALTY_FITNESS;
+  }
+
+  settling_frames = phenotype_filter_settling_frames(p,
+    FITNESS_WARMUP_TOLERANCE, reference_buffer->length);
+
+  for (i = 0; i < windows->count; i++) {
+    buf = generate_settled_segment(p, windows->start[i], FITNESS_WINDOW_LENGTH,
+                                   settling_frames, &warmup);
+
+    fitness += compare_audio_buffer_regions(buf, warmup,
+                                            reference_buffer, windows->start[i],
+                                            FITNESS_WINDOW_LENGTH);
+
+    frame_count += buf->length;
+    free_buffer(buf);
+  }
+
+#ifdef _OPENMP
+#pragma omp atomic
+#endif
+  synthesized_frame_count += frame_count;
+
+  return fitness / (float)windows->count;
+}
+
+/*
+ *  calculate_phenotype_spectral_fitness() -- calculates the fitness of a given
+ *  phenotype as the distance between its spectral envelope and the one of the
+ *  reference buffer, precomputed in `reference_features'; only the analysis
+ *  frames (see `compute_spectral_features') are synthesized, each preceded by
+ *  enough frames for the filter to settle; unstable phenotypes are handled as
+ *  in `calculate_phenotype_fitness';
+ *  @arg {struct phenotype *} p -- the phenotype in question;
+ *  @return {float}             -- the phenotype's fitness.
+ */
+float calculate_phenotype_spectral_fitness(struct phenotype *p)
+{
+  unsigned int i;
+  unsigned int warmup, settling_frames, frame_count = 0;
+  struct audio_buffer *buf;
+  struct spectral_features features;
+
+  if (!phenotype_filter_is_stable(p)) {
+    return PHENOTYPE_PENALTY_FITNESS;
+  }
+
+  settling_frames = phenotype_filter_settling_frames(p,
+    FITNESS_WARMUP_TOLERANCE, reference_buffer->length);
+
+  for (i = 0; i < SPECTRUM_FRAME_COUNT; i++) {
+    buf = generate_settled_segment(p,
+      get_spectral_frame_start(i, reference_buffer->length),
+      SPECTRUM_FRAME_LENGTH, settling_frames, &warmup);
+
+    compute_frame_features(buf->data + warmup, features.band[i]);
+
+    frame_count += buf->length;
+    free_buffer(buf);
+  }
+
+#ifdef _OPENMP
+#pragma omp atomic
+#endif
+  synthesized_frame_count += frame_count;
+
+  return compare_spectral_features(&features, &reference_features);
+}
+
+/*
+ *  fill_population_window_fitness() -- same as `fill_population_fitness', but
+ *  estimates each individual's fitness over the given windows only;
+ *  @arg {struct phenotype **} population   -- the array of individuals;
+ *  @arg {unsigned int} population_count    -- number of individuals in array;
+ *  @arg {struct fitness_windows *} windows -- the windows to compare;
+ *  @return {void}.
+ */
+void fill_population_window_fitness(struct phenotype **population,
+                                    unsigned int population_count,
+                                    struct fitness_windows *windows)
+{
+  unsigned int i;
+  unsigned int rejected = 0;
+
+#ifdef _OPENMP
+#pragma omp parallel reduction(+:rejected)
+#endif
+  {
+    apply_denormal_mode();
+
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+    for (i = 0; i < population_count; i++) {
+      population[i]->fitness =
+        calculate_phenotype_window_fitness(population[i], windows);
+
+      if (population[i]->fitness == PHENOTYPE_PENALTY_FITNESS) {
+        rejected++;
+      }
+    }
   }
+
+  fitness_evaluation_count += population_count - rejected;
+  rejected_phenotype_count += rejected;
+}
+
+/*
+ *  get_population_diversity() -- measures how spread out a population is, as
+ *  the standard deviation of each chromosome relative to that of a uniform
+ *  draw over the range `create_random_phenotype' uses, averaged over all
+ *  chromosomes; a freshly created population scores about 1.0f, and a fully
+ *  converged one 0.0f;
+ *  @arg {struct phenotype **} population -- the population in question;
+ *  @arg {unsigned int} population_count  -- number of phenotypes in population;
+ *  @return {float}                       -- the population's diversity.
+ */
+float get_population_diversity(struct phenotype **population,
+                               unsigned int population_count)
+{
+  unsigned int i, j;
+  float mean, variance, range;
+  float diversity = 0.0f;
+
+  for (j = 0; j < PHENOTYPE_CHROMOSOME_COUNT; j++) {
+    mean = 0.0f;
+    variance = 0.0f;
+    range = PHENOTYPE_CHROMOSOME_RANGE(j);
+
+    for (i = 0; i < population_count; i++) {
+      mean += population[i]->coefficient[j];
+    }
+    mean /= (float)population_count;
+
+    for (i = 0; i < population_count; i++) {
+      variance += (population[i]->coefficient[j] - mean) *
+                  (population[i]->coefficient[j] - mean);
+    }
+    variance /= (float)population_count;
+
+    /*  a uniform draw over `range' has a variance of range^2 / 12 */
+    diversity += sqrtf(variance * 12.0f) / range;
+  }
+
+  return diversity / (float)PHENOTYPE_CHROMOSOME_COUNT;
 }
 
 /*
@@ -107,11 +403,15 @@ void fill_population_fitness(struct phenotype **population,
  */
 int compare_fitness(const void *a, const void *b)
 {
-  struct phenotype *p_a = (struct phenotype *)a,
-                   *p_b = (struct phenotype *)b;
+  struct phenotype *p_a = *(struct phenotype **)a,
+                   *p_b = *(struct phenotype **)b;
 
   float res = p_b->fitness - p_a->fitness;
 
+  /*  individuals whose filter blew up are always ranked worst */
+  if (isnan(p_a->fitness) || isnan(p_b->fitness))
+    return !!isnan(p_b->fitness) - !!isnan(p_a->fitness);
+
   if (res > 0.0001f)
     return 1;
 
@@ -211,7 +511,10 @@ struct phenotype **create_generation(unsigned int phenotype_count)
 
 /*
  *  create_random_phenotype() -- creates a phenotype whose chromosomes are
- *  filled with random (uniformly distributed in the [-2.0f, 2.0f) range) data;
+ *  filled with random data, uniformly distributed in the ranges defined in
+ *  genetic.h (integer frequencies in [PHENOTYPE_MIN_FREQUENCY,
+ *  PHENOTYPE_MAX_FREQUENCY), coefficients in [PHENOTYPE_MIN_COEFFICIENT,
+ *  PHENOTYPE_MAX_COEFFICIENT));
  *  @return {struct phenotype *} -- the created phenotype.
  */
 struct phenotype *create_random_phenotype(void)
@@ -220,30 +523,206 @@ struct phenotype *create_random_phenotype(void)
 
   struct phenotype *p = alloc_phenotype();
 
-	p->coefficient[0] = 50.0f + (float)(rand() % 350);
+	p->coefficient[0] = (float)(PHENOTYPE_MIN_FREQUENCY +
+    rand() % (PHENOTYPE_MAX_FREQUENCY - PHENOTYPE_MIN_FREQUENCY));
 
   for (i = 1; i < PHENOTYPE_CHROMOSOME_COUNT; i++) {
-    p->coefficient[i] = 4.0f * ((float)(rand() % 10000) / 10000.0f) - 2.0f;
+    p->coefficient[i] = PHENOTYPE_CHROMOSOME_RANGE(i) *
+      ((float)(rand() % 10000) / 10000.0f) + PHENOTYPE_MIN_COEFFICIENT;
   }
 
   return p;
 }
 
-void run_generation(void) {
+/*
+ *  score_population() -- fills in the fitness of a population according to
+ *  `fitness_mode'; with full-length or spectral evaluation, only the first
+ *  `new_count' individuals (the ones not scored yet) are evaluated; with
+ *  windowed evaluation, estimates made over different windows are not
+ *  comparable, so the whole population is scored again over freshly picked
+ *  windows, whose number grows as the population's diversity drops; this
+ *  function is only used internally by `run_generation' and `run_evolution';
+ *  @arg {struct phenotype **} population -- the population to score;
+ *  @arg {unsigned int} population_count  -- number of phenotypes in population;
+ *  @arg {unsigned int} new_count         -- number of unscored phenotypes, at
+ *                                           the start of the population;
+ *  @return {void}.
+ */
+static void score_population(struct phenotype **population,
+                             unsigned int population_count,
+                             unsigned int new_count)
+{
+  float convergence;
+  unsigned int window_count;
+  struct fitness_windows windows;
+
+  if (fitness_mode != FITNESS_WINDOWED) {
+    fill_population_fitness(population, new_count);
+    return;
+  }
+
+  convergence = 1.0f - get_population_diversity(population, population_count);
+  if (convergence < 0.0f)
+    convergence = 0.0f;
+
+  window_count = FITNESS_MIN_WINDOWS + (unsigned int)(convergence *
+    (float)(FITNESS_MAX_WINDOWS - FITNESS_MIN_WINDOWS) + 0.5f);
+
+  choose_fitness_windows(&windows, window_count);
+  fill_population_window_fitness(population, population_count, &windows);
+}
+
+/*
+ *  run_generation() -- advances a population by one generation; offspring of
+ *  tournament winners replace the weaker half of the population, which is
+ *  expected to be sorted by `sort_population_by_fitness' (worst individuals
+ *  first); the population is then scored (see `score_population') and sorted
+ *  again before returning; when a trained surrogate model is given,
+ *  SURROGATE_CANDIDATE_FACTOR times as many candidate offspring are bred, and
+ *  only the ones it ranks best fill the offspring slots; the surrogate learns
+ *  from every evaluated offspring;
+ *  @arg {struct phenotype **} population -- the population to advance;
+ *  @arg {unsigned int} population_count  -- number of phenotypes in population;
+ *  @arg {struct surrogate *} s           -- surrogate model used to screen the
+ *                                           offspring, or NULL;
+ *  @return {void}.
+ */
+void run_generation(struct phenotype **population,
+                    unsigned int population_count,
+                    struct surrogate *s)
+{
   unsigned int i;
+  unsigned int offspring_count = population_count / 2;
+  unsigned int candidate_count = offspring_count;
+  struct phenotype **offspring;
 
-  struct phenotype **generation = create_generation(100);
-  struct phenotype *tournament_winners[20];
+  if (s != NULL && surrogate_is_trained(s)) {
+    candidate_count = offspring_count * SURROGATE_CANDIDATE_FACTOR;
+  }
 
-  fill_population_fitness(generation, 100);
-  for (i = 0; i < 20; i++) {
-    tournament_winners[i] = get_best_of_random_two(generation, 100);
-    printf("%i: %f\n", i, tournament_winners[i]->fitness);
+  offspring = (struct phenotype **)malloc(
+    sizeof(struct phenotype *) * candidate_count);
+
+  for (i = 0; i < candidate_count; i++) {
+    offspring[i] = combine_phenotypes(
+      get_best_of_random_two(population, population_count),
+      get_best_of_random_two(population, population_count));
+  }
+
+  if (candidate_count > offspring_count) {
+    screen_offspring(s, offspring, candidate_count, offspring_count);
+
+    for (i = offspring_count; i < candidate_count; i++) {
+      free_phenotype(offspring[i]);
+    }
   }
 
-  for (i = 0; i < 100; i++) {
-    free_phenotype(generation[i]);
+  for (i = 0; i < offspring_count; i++) {
+    free_phenotype(population[i]);
+    population[i] = offspring[i];
   }
-  free(generation);
+  free(offspring);
+
+  score_population(population, population_count, offspring_count);
+
+  if (s != NULL) {
+    if (candidate_count > offspring_count) {
+      rate_surrogate_ranking(s, population, offspring_count);
+    }
+    add_surrogate_samples(s, population, offspring_count);
+  }
+
+  sort_population_by_fitness(population, population_count);
+}
+
+/*
+ *  run_evolution() -- evolves a random population until either its best
+ *  individual reaches `target_fitness' or `generation_count' generations have
+ *  passed; with windowed evaluation, the best individual is only considered
+ *  to reach the target once confirmed over the whole reference buffer, and
+ *  the final elites are confirmed likewise before picking the best one;
+ *  offspring are screened by a surrogate model when `surrogate_screening' is
+ *  set, which is not supported with windowed evaluation; please note that
+ *  the returned phenotype is allocated here, thus it is necessary to handle
+ *  its destruction separately;
+ *  @arg {unsigned int} population_count -- number of phenotypes in population;
+ *  @arg {unsigned int} generation_count -- maximum number of generations;
+ *  @arg {float} target_fitness          -- fitness at which to stop early;
+ *  @return {struct phenotype *}         -- a copy of the best individual.
+ */
+struct phenotype *run_evolution(unsigned int population_count,
+                                unsigned int generation_count,
+                                float target_fitness)
+{
+  unsigned int i;
+  unsigned int elite_count;
+  int confirmed;
+  unsigned long first_frame;
+  struct phenotype *best;
+  struct surrogate *s = NULL;
+
+  struct phenotype **population = create_generation(population_count);
+
+  score_population(population, population_count, population_count);
+
+  if (surrogate_screening) {
+    s = alloc_surrogate();
+    add_surrogate_samples(s, population, population_count);
+  }
+
+  sort_population_by_fitness(population, population_count);
+
+  for (i = 0; i < generation_count; i++) {
+    if (population[population_count - 1]->fitness <= target_fitness) {
+      if (fitness_mode != FITNESS_WINDOWED) {
+        break;
+      }
+
+        /*  a window estimate may be lucky; confirm it on the whole buffer,
+            on a copy so the population's estimates stay comparable */
+      best = copy_phenotype(population[population_count - 1]);
+      fill_population_fitness(&best, 1);
+      confirmed = (best->fitness <= target_fitness);
+      free_phenotype(best);
+
+      if (confirmed) {
+        break;
+      }
+    }
+
+    first_frame = synthesized_frame_count;
+    run_generation(population, population_count, s);
+    printf("generation %u: %f (%lu frames synthesized)\n", i,
+           population[population_count - 1]->fitness,
+           synthesized_frame_count - first_frame);
+  }
+
+  if (fitness_mode == FITNESS_WINDOWED) {
+    elite_count = (population_count < FITNESS_CONFIRMED_ELITES) ?
+      population_count : FITNESS_CONFIRMED_ELITES;
+
+    fill_population_fitness(population + population_count - elite_count,
+                            elite_count);
+    sort_population_by_fitness(population + population_count - elite_count,
+                               elite_count);
+  }
+
+  if (s != NULL) {
+    printf("surrogate: %lu of %lu candidate offspring discarded unevaluated, "
+           "mean rank correlation %f\n",
+           s->discarded_count, s->screened_count,
+           (s->ranking_count > 0) ?
+             s->rank_correlation_sum / (float)s->ranking_count : 0.0f);
+    free_surrogate(s);
+  }
+
+  best = copy_phenotype(population[population_count - 1]);
+
+  for (i = 0; i < population_count; i++) {
+    free_phenotype(population[i]);
+  }
+  free(population);
+
+  return best;
 }
 
@@ -25,22 +25,84 @@
 
 #pragma once
 
+#include <float.h>
+
 #define PHENOTYPE_CHROMOSOME_COUNT 5
 
+/*  ranges `create_random_phenotype' draws chromosomes from: the base frequency
+    (chromosome 0) in [PHENOTYPE_MIN_FREQUENCY, PHENOTYPE_MAX_FREQUENCY), and
+    the filter coefficients in [PHENOTYPE_MIN_COEFFICIENT,
+    PHENOTYPE_MAX_COEFFICIENT) */
+#define PHENOTYPE_MIN_FREQUENCY   50
+#define PHENOTYPE_MAX_FREQUENCY   400
+#define PHENOTYPE_MIN_COEFFICIENT -2.0f
+#define PHENOTYPE_MAX_COEFFICIENT 2.0f
+
+/*  width of the range chromosome `i' is initially drawn from */
+#define PHENOTYPE_CHROMOSOME_RANGE(i) ((i) == 0 ? \
+  (float)(PHENOTYPE_MAX_FREQUENCY - PHENOTYPE_MIN_FREQUENCY) : \
+  (PHENOTYPE_MAX_COEFFICIENT - PHENOTYPE_MIN_COEFFICIENT))
+
+/*  fitness assigned to phenotypes whose filter is unstable */
+#define PHENOTYPE_PENALTY_FITNESS FLT_MAX
+
+/*  windowed fitness evaluation; the number of windows grows from
+    FITNESS_MIN_WINDOWS to FITNESS_MAX_WINDOWS as the population converges */
+#define FITNESS_WINDOW_LENGTH    512
+#define FITNESS_MIN_WINDOWS      1
+#define FITNESS_MAX_WINDOWS      4
+#define FITNESS_WARMUP_TOLERANCE 1e-4f
+#define FITNESS_CONFIRMED_ELITES 10
+
+enum fitness_mode {
+  FITNESS_FULL,     /* mean square error over the whole reference buffer */
+  FITNESS_WINDOWED, /* mean square error over a few random windows of it */
+  FITNESS_SPECTRAL  /* distance between spectral envelopes */
+};
+
 struct phenotype {
   float coefficient[PHENOTYPE_CHROMOSOME_COUNT];
   float fitness;
 };
 
+struct fitness_windows {
+  unsigned int count;
+  unsigned int start[FITNESS_MAX_WINDOWS];
+};
+
+extern enum fitness_mode fitness_mode;
+extern int surrogate_screening;
+
+extern unsigned long fitness_evaluation_count;
+extern unsigned long rejected_phenotype_count;
+extern unsigned long synthesized_frame_count;
+
 struct phenotype *alloc_phenotype(void);
 
 void free_phenotype(struct phenotype *p);
 
+struct phenotype *copy_phenotype(struct phenotype *p);
+
 float calculate_phenotype_fitness(struct phenotype *p);
 
 void fill_population_fitness(struct phenotype **population,
                              unsigned int population_count);
 
+void choose_fitness_windows(struct fitness_windows *windows,
+                            unsigned int window_count);
+
+float calculate_phenotype_window_fitness(struct phenotype *p,
+                                         struct fitness_windows *windows);
+
+float calculate_phenotype_spectral_fitness(struct phenotype *p);
+
+void fill_population_window_fitness(struct phenotype **population,
+                                    unsigned int population_count,
+                                    struct fitness_windows *windows);
+
+float get_population_diversity(struct phenotype **population,
+                               unsigned int population_count);
+
 int compare_fitness(const void *a, const void *b);
 
 void sort_population_by_fitness(struct phenotype **population,
@@ -55,5 +117,13 @@ struct phenotype **create_generation(unsigned int phenotype_count);
 
 struct phenotype *create_random_phenotype(void);
 
-void run_generation(void);
+struct surrogate;
+
+void run_generation(struct phenotype **population,
+                    unsigned int population_count,
+                    struct surrogate *s);
+
+struct phenotype *run_evolution(unsigned int population_count,
+                                unsigned int generation_count,
+                                float target_fitness);
 
@@ -0,0 +1,241 @@
+
+/*
+ *  simplex.c ~ speech synthesis toy project
+ *
+ *  Copyright (c) 2016, Vlad Dumitru <dalv.urtimud@gmail.com>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "genetic.h"
+#include "simplex.h"
+
+#define SIMPLEX_VERTEX_COUNT (PHENOTYPE_CHROMOSOME_COUNT + 1)
+
+/*  standard Nelder-Mead reflection, expansion, contraction and shrink factors */
+#define SIMPLEX_ALPHA 1.0f
+#define SIMPLEX_GAMMA 2.0f
+#define SIMPLEX_RHO   0.5f
+#define SIMPLEX_SIGMA 0.5f
+
+/*  candidate points evaluated together in every iteration */
+#define SIMPLEX_REFLECTED 0
+#define SIMPLEX_EXPANDED  1
+#define SIMPLEX_OUTSIDE   2
+#define SIMPLEX_INSIDE    3
+#define SIMPLEX_CANDIDATE_COUNT 4
+
+/*  the simplex is considered collapsed once its vertices' fitness values lie
+    closer than this */
+#define SIMPLEX_TOLERANCE 1e-7f
+
+/*  size of the initial simplex, relative to the range each chromosome is
+    initially drawn from */
+#define SIMPLEX_STEP 0.05f
+
+/*
+ *  compare_vertices() -- compares two simplex vertices by their fitness, in
+ *  ascending order (best vertex first); this function is only used internally
+ *  by `refine_phenotype';
+ *  @arg {const void *} a -- first vertex to compare;
+ *  @arg {const void *} b -- second vertex to compare;
+ *  @return {int}         -- comparison result.
+ */
+static int compare_vertices(const void *a, const void *b)
+{
+  struct phenotype *p_a = *(struct phenotype **)a,
+                   *p_b = *(struct phenotype **)b;
+
+  if (isnan(p_a->fitness) || isnan(p_b->fitness))
+    return !!isnan(p_a->fitness) - !!isnan(p_b->fitness);
+
+  if (p_a->fitness < p_b->fitness)
+    return -1;
+
+  if (p_a->fitness > p_b->fitness)
+    return 1;
+
+  return 0;
+}
+
+/*
+ *  clamp_frequency() -- keeps a vertex's base frequency within the range
+ *  `create_random_phenotype' draws it from, otherwise the pulse period
+ *  degenerates; this function is only used internally by `refine_phenotype'
+ *  and `move_vertex';
+ *  @arg {struct phenotype *} p -- the vertex in question;
+ *  @return {void}.
+ */
+static void clamp_frequency(struct phenotype *p)
+{
+  if (p->coefficient[0] < (float)PHENOTYPE_MIN_FREQUENCY)
+    p->coefficient[0] = (float)PHENOTYPE_MIN_FREQUENCY;
+
+  if (p->coefficient[0] > (float)PHENOTYPE_MAX_FREQUENCY)
+    p->coefficient[0] = (float)PHENOTYPE_MAX_FREQUENCY;
+}
+
+/*
+ *  move_vertex() -- writes the point `origin + factor * (target - origin)'
+ *  into a given phenotype, keeping the base frequency in its valid range;
+ *  @arg {struct phenotype *} result -- phenotype to receive the point;
+ *  @arg {float *} origin            -- coefficients of the origin point;
+ *  @arg {float *} target            -- coefficients of the target point;
+ *  @arg {float} factor              -- interpolation factor;
+ *  @return {void}.
+ */
+static void move_vertex(struct phenotype *result, float *origin, float *target,
+                        float factor)
+{
+  unsigned int i;
+
+  for (i = 0; i < PHENOTYPE_CHROMOSOME_COUNT; i++) {
+    result->coefficient[i] = origin[i] + factor * (target[i] - origin[i]);
+  }
+
+  clamp_frequency(result);
+}
+
+/*
+ *  refine_phenotype() -- polishes a phenotype (typically the elite of a genetic
+ *  run) with the Nelder-Mead simplex method; every evaluation goes through
+ *  `fill_population_fitness' as a parallel batch: the initial simplex, every
+ *  shrink step, and, in each iteration, the reflection, expansion and both
+ *  contraction points at once, at the price of evaluating points the
+ *  sequential method would not have needed; the phenotype is overwritten with
+ *  the best point found, and is expected to have its fitness already filled
+ *  in;
+ *  @arg {struct phenotype *} p            -- the phenotype to be refined;
+ *  @arg {unsigned int} evaluation_budget  -- number of fitness evaluations
+ *                                            after which no new iteration is
+ *                                            started;
+ *  @arg {float} target_fitness            -- fitness at which to stop early;
+ *  @return {unsigned int}                 -- number of evaluations spent.
+ */
+unsigned int refine_phenotype(struct phenotype *p,
+                              unsigned int evaluation_budget,
+                              float target_fitness)
+{
+  unsigned int i, j;
+  unsigned long first_evaluation = fitness_evaluation_count;
+  float step;
+  float centroid[PHENOTYPE_CHROMOSOME_COUNT];
+  struct phenotype *simplex[SIMPLEX_VERTEX_COUNT];
+  struct phenotype *candidate[SIMPLEX_CANDIDATE_COUNT];
+  struct phenotype *reflected, *best, *worst;
+
+  simplex[0] = copy_phenotype(p);
+  for (i = 1; i < SIMPLEX_VERTEX_COUNT; i++) {
+    simplex[i] = copy_phenotype(p);
+    step = SIMPLEX_STEP * PHENOTYPE_CHROMOSOME_RANGE(i - 1);
+
+      /*  step downwards from a base frequency at the top of its range, so
+          that clamping does not flatten the simplex */
+    if (i == 1 && p->coefficient[0] + step > (float)PHENOTYPE_MAX_FREQUENCY)
+      step = -step;
+
+    simplex[i]->coefficient[i - 1] += step;
+    clamp_frequency(simplex[i]);
+  }
+  fill_population_fitness(simplex + 1, PHENOTYPE_CHROMOSOME_COUNT);
+
+  for (i = 0; i < SIMPLEX_CANDIDATE_COUNT; i++) {
+    candidate[i] = alloc_phenotype();
+  }
+  reflected = candidate[SIMPLEX_REFLECTED];
+
+  while (fitness_evaluation_count - first_evaluation + SIMPLEX_CANDIDATE_COUNT
+         <= evaluation_budget) {
+    qsort(simplex, SIMPLEX_VERTEX_COUNT, sizeof(struct phenotype *),
+          compare_vertices);
+
+    best = simplex[0];
+    worst = simplex[SIMPLEX_VERTEX_COUNT - 1];
+
+    if (best->fitness <= target_fitness ||
+        worst->fitness - best->fitness < SIMPLEX_TOLERANCE) {
+      break;
+    }
+
+    for (j = 0; j < PHENOTYPE_CHROMOSOME_COUNT; j++) {
+      centroid[j] = 0.0f;
+      for (i = 0; i < SIMPLEX_VERTEX_COUNT - 1; i++) {
+        centroid[j] += simplex[i]->coefficient[j];
+      }
+      centroid[j] /= (float)(SIMPLEX_VERTEX_COUNT - 1);
+    }
+
+    move_vertex(reflected, centroid, worst->coefficient, -SIMPLEX_ALPHA);
+    move_vertex(candidate[SIMPLEX_EXPANDED], centroid, reflected->coefficient,
+                SIMPLEX_GAMMA);
+    move_vertex(candidate[SIMPLEX_OUTSIDE], centroid, reflected->coefficient,
+                SIMPLEX_RHO);
+    move_vertex(candidate[SIMPLEX_INSIDE], centroid, worst->coefficient,
+                SIMPLEX_RHO);
+    fill_population_fitness(candidate, SIMPLEX_CANDIDATE_COUNT);
+
+    if (reflected->fitness < best->fitness) {
+      *worst = (candidate[SIMPLEX_EXPANDED]->fitness < reflected->fitness) ?
+        *candidate[SIMPLEX_EXPANDED] : *reflected;
+      continue;
+    }
+
+    if (reflected->fitness < simplex[SIMPLEX_VERTEX_COUNT - 2]->fitness) {
+      *worst = *reflected;
+      continue;
+    }
+
+    if (reflected->fitness < worst->fitness) {
+      if (candidate[SIMPLEX_OUTSIDE]->fitness <= reflected->fitness) {
+        *worst = *candidate[SIMPLEX_OUTSIDE];
+        continue;
+      }
+    } else if (candidate[SIMPLEX_INSIDE]->fitness < worst->fitness) {
+      *worst = *candidate[SIMPLEX_INSIDE];
+      continue;
+    }
+
+    for (i = 1; i < SIMPLEX_VERTEX_COUNT; i++) {
+      move_vertex(simplex[i], best->coefficient, simplex[i]->coefficient,
+                  SIMPLEX_SIGMA);
+    }
+    fill_population_fitness(simplex + 1, PHENOTYPE_CHROMOSOME_COUNT);
+  }
+
+  qsort(simplex, SIMPLEX_VERTEX_COUNT, sizeof(struct phenotype *),
+        compare_vertices);
+
+  if (simplex[0]->fitness < p->fitness) {
+    *p = *simplex[0];
+  }
+
+  for (i = 0; i < SIMPLEX_VERTEX_COUNT; i++) {
+    free_phenotype(simplex[i]);
+  }
+  for (i = 0; i < SIMPLEX_CANDIDATE_COUNT; i++) {
+    free_phenotype(candidate[i]);
+  }
+
+  return fitness_evaluation_count - first_evaluation;
+}
+
@@ -0,0 +1,183 @@
+
+/*
+ *  spectrum.c ~ speech synthesis toy project
+ *
+ *  Copyright (c) 2016, Vlad Dumitru <dalv.urtimud@gmail.com>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#include <math.h>
+
+#include "audiobuffer.h"
+#include "spectrum.h"
+
+/*  keeps silent bands from taking the logarithm of zero */
+#define SPECTRUM_ENERGY_FLOOR 1e-12f
+
+/*
+ *  fft() -- computes the discrete Fourier transform of a complex signal, in
+ *  place, using the iterative radix-2 Cooley-Tukey algorithm;
+ *  @arg {float *} real         -- real parts of the signal;
+ *  @arg {float *} imag         -- imaginary parts of the signal;
+ *  @arg {unsigned int} length  -- number of samples; must be a power of two;
+ *  @return {void}.
+ */
+void fft(float *real, float *imag, unsigned int length)
+{
+  unsigned int i, j, k, span;
+  float temp_real, temp_imag;
+  double w_real, w_imag, step_real, step_imag, temp;
+
+    /*  bit-reversal permutation */
+  for (i = 1, j = 0; i < length; i++) {
+    k = length >> 1;
+    while (j & k) {
+      j ^= k;
+      k >>= 1;
+    }
+    j |= k;
+
+    if (i < j) {
+      temp_real = real[i]; real[i] = real[j]; real[j] = temp_real;
+      temp_imag = imag[i]; imag[i] = imag[j]; imag[j] = temp_imag;
+    }
+  }
+
+    /*  butterflies; twiddle factors are advanced by complex multiplication,
+        in double precision to keep the recurrence from drifting */
+  for (span = 1; span < length; span <<= 1) {
+    step_real = cos(M_PI / (double)span);
+    step_imag = -sin(M_PI / (double)span);
+    w_real = 1.0;
+    w_imag = 0.0;
+
+    for (k = 0; k < span; k++) {
+      for (i = k; i < length; i += span << 1) {
+        j = i + span;
+        temp_real = (float)w_real * real[j] - (float)w_imag * imag[j];
+        temp_imag = (float)w_real * imag[j] + (float)w_imag * real[j];
+
+        real[j] = real[i] - temp_real;
+        imag[j] = imag[i] - temp_imag;
+        real[i] += temp_real;
+        imag[i] += temp_imag;
+      }
+
+      temp = w_real * step_real - w_imag * step_imag;
+      w_imag = w_real * step_imag + w_imag * step_real;
+      w_real = temp;
+    }
+  }
+}
+
+/*
+ *  get_spectral_frame_start() -- calculates where a given analysis frame
+ *  starts; frames are spread evenly, the first starting at the beginning of
+ *  the buffer and the last ending at its end;
+ *  @arg {unsigned int} frame         -- index of the frame;
+ *  @arg {unsigned int} buffer_length -- length of the analysed buffer;
+ *  @return {unsigned int}            -- index of the frame's first sample.
+ */
+unsigned int get_spectral_frame_start(unsigned int frame,
+                                      unsigned int buffer_length)
+{
+  return frame * ((buffer_length - SPECTRUM_FRAME_LENGTH) /
+                  (SPECTRUM_FRAME_COUNT - 1));
+}
+
+/*
+ *  compute_frame_features() -- computes the spectral envelope of a single
+ *  frame, as the logarithm of its power in each band, after applying a Hann
+ *  window;
+ *  @arg {float *} frame -- SPECTRUM_FRAME_LENGTH samples to analyse;
+ *  @arg {float *} bands -- array of SPECTRUM_BAND_COUNT values to be filled;
+ *  @return {void}.
+ */
+void compute_frame_features(float *frame, float *bands)
+{
+  unsigned int i, j;
+  unsigned int bins_per_band = SPECTRUM_FRAME_LENGTH / 2 / SPECTRUM_BAND_COUNT;
+  float real[SPECTRUM_FRAME_LENGTH], imag[SPECTRUM_FRAME_LENGTH];
+  float phase, energy;
+
+  for (i = 0; i < SPECTRUM_FRAME_LENGTH; i++) {
+    phase = 2.0f * M_PI * (float)i / (float)(SPECTRUM_FRAME_LENGTH - 1);
+    real[i] = frame[i] * (0.5f - 0.5f * cosf(phase));
+    imag[i] = 0.0f;
+  }
+
+  fft(real, imag, SPECTRUM_FRAME_LENGTH);
+
+  for (i = 0; i < SPECTRUM_BAND_COUNT; i++) {
+    energy = 0.0f;
+
+    for (j = i * bins_per_band; j < (i + 1) * bins_per_band; j++) {
+      energy += real[j] * real[j] + imag[j] * imag[j];
+    }
+
+    bands[i] = logf(energy + SPECTRUM_ENERGY_FLOOR);
+  }
+}
+
+/*
+ *  compute_spectral_features() -- computes the spectral envelope of every
+ *  analysis frame of a given buffer;
+ *  @arg {struct audio_buffer *} buf             -- the buffer to analyse; must
+ *                                                  hold at least
+ *                                                  SPECTRUM_FRAME_LENGTH
+ *                                                  frames;
+ *  @arg {struct spectral_features *} features   -- the structure to be filled;
+ *  @return {void}.
+ */
+void compute_spectral_features(struct audio_buffer *buf,
+                               struct spectral_features *features)
+{
+  unsigned int i;
+
+  for (i = 0; i < SPECTRUM_FRAME_COUNT; i++) {
+    compute_frame_features(buf->data + get_spectral_frame_start(i, buf->length),
+                           features->band[i]);
+  }
+}
+
+/*
+ *  compare_spectral_features() -- calculates the mean square difference
+ *  between two sets of spectral features; as they are logarithms of band
+ *  powers, this compares the envelopes' shapes and levels regardless of phase;
+ *  @arg {struct spectral_features *} a -- first set of features;
+ *  @arg {struct spectral_features *} b -- second set of features;
+ *  @return {float}                     -- the mean square difference.
+ */
+float compare_spectral_features(struct spectral_features *a,
+                                struct spectral_features *b)
+{
+  unsigned int i, j;
+  float difference = 0.0f;
+
+  for (i = 0; i < SPECTRUM_FRAME_COUNT; i++) {
+    for (j = 0; j < SPECTRUM_BAND_COUNT; j++) {
+      difference += (a->band[i][j] - b->band[i][j]) *
+                    (a->band[i][j] - b->band[i][j]);
+    }
+  }
+
+  return difference / (float)(SPECTRUM_FRAME_COUNT * SPECTRUM_BAND_COUNT);
+}
+
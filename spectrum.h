@@ -0,0 +1,54 @@
+
+/*
+ *  spectrum.h ~ speech synthesis toy project
+ *
+ *  Copyright (c) 2016, Vlad Dumitru <dalv.urtimud@gmail.com>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "audiobuffer.h"
+
+/*  the spectral envelope is taken over SPECTRUM_FRAME_COUNT frames spread
+    evenly over a buffer; each frame's power spectrum is summed into
+    SPECTRUM_BAND_COUNT equally wide bands, wide enough to smooth out the
+    harmonics of the base signal */
+#define SPECTRUM_FRAME_LENGTH 1024
+#define SPECTRUM_FRAME_COUNT  8
+#define SPECTRUM_BAND_COUNT   32
+
+struct spectral_features {
+  float band[SPECTRUM_FRAME_COUNT][SPECTRUM_BAND_COUNT];
+};
+
+void fft(float *real, float *imag, unsigned int length);
+
+unsigned int get_spectral_frame_start(unsigned int frame,
+                                      unsigned int buffer_length);
+
+void compute_frame_features(float *frame, float *bands);
+
+void compute_spectral_features(struct audio_buffer *buf,
+                               struct spectral_features *features);
+
+float compare_spectral_features(struct spectral_features *a,
+                                struct spectral_features *b);
+
@@ -27,6 +27,7 @@
 #include <stdlib.h>
 #include <math.h>
 #include <time.h>
+#include <unistd.h>
 
 #include <sndfile.h>
 
@@ -34,13 +35,115 @@
 #include "synth.h"
 #include "genetic.h"
 #include "speech.h"
+#include "simplex.h"
+
+#define POPULATION_SIZE 100
 
 struct audio_buffer *reference_buffer = NULL;
+struct spectral_features reference_features;
+
+/*
+ *  run_search() -- runs the genetic algorithm, optionally followed by a
+ *  Nelder-Mead refinement of its elite, and reports the number of fitness
+ *  evaluations each stage took;
+ *  @arg {const char *} label            -- name of the run, used in the report;
+ *  @arg {unsigned int} generation_count -- maximum number of generations;
+ *  @arg {unsigned int} refine_budget    -- evaluation budget of the refinement
+ *                                          stage; zero disables it;
+ *  @arg {float} target_fitness          -- fitness at which to stop early;
+ *  @return {void}.
+ */
+static void run_search(const char *label, unsigned int generation_count,
+                       unsigned int refine_budget, float target_fitness)
+{
+  unsigned long genetic_evaluations = 0, refine_evaluations = 0;
+  struct phenotype *best;
+
+  fitness_evaluation_count = 0;
+  rejected_phenotype_count = 0;
+  synthesized_frame_count = 0;
+  best = run_evolution(POPULATION_SIZE, generation_count, target_fitness);
+  genetic_evaluations = fitness_evaluation_count;
+
+  if (refine_budget > 0 && best->fitness > target_fitness) {
+    refine_evaluations = refine_phenotype(best, refine_budget, target_fitness);
+  }
+
+  printf("%s: fitness %f after %lu evaluations (%lu genetic, %lu refinement)\n",
+         label, best->fitness, genetic_evaluations + refine_evaluations,
+         genetic_evaluations, refine_evaluations);
+  printf("%s: %lu unstable phenotypes rejected before synthesis\n", label,
+         rejected_phenotype_count);
+  printf("%s: %lu frames synthesized\n", label, synthesized_frame_count);
+  printf("%s: %f %f %f %f %f\n", label,
+         best->coefficient[0], best->coefficient[1], best->coefficient[2],
+         best->coefficient[3], best->coefficient[4]);
+
+  free_phenotype(best);
+}
 
 int main(int argc, char **argv)
 {
-  (void) argc;
-  (void) argv;
+  int option;
+  enum fitness_mode mode;
+  int refine = 0,                     /* run the hybrid search */
+      compare = 0;                    /* run both searches, one after another */
+  unsigned int generation_count = 100,
+               handoff_generation = 20, /* hybrid search's genetic stage */
+               refine_budget = 500;
+  float target_fitness = 0.0f;
+
+  while ((option = getopt(argc, argv, "rczwspg:n:e:t:")) != -1) {
+    switch (option) {
+    case 'r':
+      refine = 1;
+      break;
+    case 'c':
+      compare = 1;
+      break;
+    case 'z':
+      flush_denormals = 1;
+      break;
+    case 'w':
+    case 's':
+      mode = (option == 'w') ? FITNESS_WINDOWED : FITNESS_SPECTRAL;
+      if (fitness_mode != FITNESS_FULL && fitness_mode != mode) {
+        fprintf(stderr, "-w and -s cannot be combined.\n");
+        return 1;
+      }
+      fitness_mode = mode;
+      break;
+    case 'p':
+      surrogate_screening = 1;
+      break;
+    case 'g':
+      generation_count = atoi(optarg);
+      break;
+    case 'n':
+      handoff_generation = atoi(optarg);
+      break;
+    case 'e':
+      refine_budget = atoi(optarg);
+      break;
+    case 't':
+      target_fitness = atof(optarg);
+      break;
+    default:
+      fprintf(stderr, "usage: %s [-r] [-c] [-z] [-w] [-s] [-p] "
+                      "[-g generations] "
+                      "[-n hybrid generations] [-e refine evaluations] "
+                      "[-t target fitness]\n", argv[0]);
+      return 1;
+    }
+  }
+
+    /*  windowed mode rescores the whole population every generation, so
+        screening offspring would not save any evaluation, and its window
+        estimates are not comparable enough to train the surrogate on */
+  if (surrogate_screening && fitness_mode == FITNESS_WINDOWED) {
+    fprintf(stderr, "-p and -w cannot be combined.\n");
+    return 1;
+  }
 
   srand(time(NULL));
 
@@ -66,7 +169,17 @@ int main(int argc, char **argv)
   reference_file = sf_open("reference_a.wav", SFM_READ, &sfinfo);
   sf_read_float(reference_file, reference_buffer->data, SAMPLE_RATE);
 
-  run_generation();
+  if (fitness_mode == FITNESS_SPECTRAL) {
+    compute_spectral_features(reference_buffer, &reference_features);
+  }
+
+  if (compare || !refine) {
+    run_search("ga-only", generation_count, 0, target_fitness);
+  }
+
+  if (compare || refine) {
+    run_search("hybrid", handoff_generation, refine_budget, target_fitness);
+  }
 
   free_buffer(reference_buffer);
   sf_close(reference_file);
@@ -26,6 +26,8 @@
 #pragma once
 
 #include "audiobuffer.h"
+#include "spectrum.h"
 
 extern struct audio_buffer *reference_buffer;
+extern struct spectral_features reference_features;
 
@@ -0,0 +1,296 @@
+
+/*
+ *  surrogate.c ~ speech synthesis toy project
+ *
+ *  Copyright (c) 2016, Vlad Dumitru <dalv.urtimud@gmail.com>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <math.h>
+
+#include "genetic.h"
+#include "surrogate.h"
+#include "synth.h"
+
+/*  keeps a perfect fitness from taking the logarithm of zero */
+#define SURROGATE_FITNESS_FLOOR 1e-12f
+
+/*
+ *  alloc_surrogate() -- allocates an empty surrogate model;
+ *  @return {struct surrogate *} -- the allocated surrogate.
+ */
+struct surrogate *alloc_surrogate(void)
+{
+  struct surrogate *s = (struct surrogate*) malloc(sizeof(struct surrogate));
+
+  s->sample_count = 0;
+  s->next_sample = 0;
+  s->screened_count = 0;
+  s->discarded_count = 0;
+  s->rank_correlation_sum = 0.0f;
+  s->ranking_count = 0;
+
+  return s;
+}
+
+/*
+ *  free_surrogate() -- frees a given surrogate model;
+ *  @arg {struct surrogate *} s -- the surrogate in question;
+ *  @return {void}.
+ */
+void free_surrogate(struct surrogate *s)
+{
+  free(s);
+}
+
+/*
+ *  add_surrogate_samples() -- teaches the surrogate the fitness of evaluated
+ *  phenotypes; unstable phenotypes are skipped, as `predict_phenotype_fitness'
+ *  recognizes them without help; fitness is remembered as its logarithm, so
+ *  that interpolation is not dominated by the worst phenotypes;
+ *  @arg {struct surrogate *} s           -- the surrogate in question;
+ *  @arg {struct phenotype **} population -- the evaluated phenotypes;
+ *  @arg {unsigned int} population_count  -- number of phenotypes;
+ *  @return {void}.
+ */
+void add_surrogate_samples(struct surrogate *s, struct phenotype **population,
+                           unsigned int population_count)
+{
+  unsigned int i, j;
+
+  for (i = 0; i < population_count; i++) {
+    if (population[i]->fitness == PHENOTYPE_PENALTY_FITNESS) {
+      continue;
+    }
+
+    for (j = 0; j < PHENOTYPE_CHROMOSOME_COUNT; j++) {
+      s->coefficient[s->next_sample][j] = population[i]->coefficient[j];
+    }
+    s->log_fitness[s->next_sample] =
+      logf(population[i]->fitness + SURROGATE_FITNESS_FLOOR);
+
+    s->next_sample = (s->next_sample + 1) % SURROGATE_ARCHIVE_SIZE;
+    if (s->sample_count < SURROGATE_ARCHIVE_SIZE) {
+      s->sample_count++;
+    }
+  }
+}
+
+/*
+ *  surrogate_is_trained() -- tells whether a surrogate remembers enough
+ *  phenotypes (SURROGATE_MIN_SAMPLES) for its predictions to be used;
+ *  @arg {struct surrogate *} s -- the surrogate in question;
+ *  @return {int}               -- non-zero if the surrogate is trained.
+ */
+int surrogate_is_trained(struct surrogate *s)
+{
+  return s->sample_count >= SURROGATE_MIN_SAMPLES;
+}
+
+/*
+ *  predict_phenotype_fitness() -- predicts the logarithm of a phenotype's
+ *  fitness by inverse distance weighting of its SURROGATE_NEIGHBOUR_COUNT
+ *  nearest remembered phenotypes; distances are measured relative to the
+ *  ranges `create_random_phenotype' draws each chromosome from; unstable
+ *  phenotypes are predicted as bad as possible;
+ *  @arg {struct surrogate *} s -- the surrogate in question; must remember at
+ *                                 least one phenotype;
+ *  @arg {struct phenotype *} p -- the phenotype in question;
+ *  @return {float}             -- the predicted logarithm of its fitness.
+ */
+float predict_phenotype_fitness(struct surrogate *s, struct phenotype *p)
+{
+  unsigned int i, j, k;
+  unsigned int neighbour_count = 0;
+  float distance[SURROGATE_NEIGHBOUR_COUNT];
+  float value[SURROGATE_NEIGHBOUR_COUNT];
+  float d, delta, weight, weight_sum = 0.0f, prediction = 0.0f;
+
+  if (!phenotype_filter_is_stable(p)) {
+    return logf(PHENOTYPE_PENALTY_FITNESS);
+  }
+
+  for (i = 0; i < s->sample_count; i++) {
+    d = 0.0f;
+    for (j = 0; j < PHENOTYPE_CHROMOSOME_COUNT; j++) {
+      delta = (p->coefficient[j] - s->coefficient[i][j]) /
+              PHENOTYPE_CHROMOSOME_RANGE(j);
+      d += delta * delta;
+    }
+
+    if (neighbour_count == SURROGATE_NEIGHBOUR_COUNT &&
+        d >= distance[neighbour_count - 1]) {
+      continue;
+    }
+
+      /*  insert into the neighbour list, which is kept sorted by distance */
+    if (neighbour_count < SURROGATE_NEIGHBOUR_COUNT) {
+      neighbour_count++;
+    }
+    for (k = neighbour_count - 1; k > 0 && distance[k - 1] > d; k--) {
+      distance[k] = distance[k - 1];
+      value[k] = value[k - 1];
+    }
+    distance[k] = d;
+    value[k] = s->log_fitness[i];
+  }
+
+  for (k = 0; k < neighbour_count; k++) {
+    if (distance[k] == 0.0f) {
+      return value[k];
+    }
+
+    weight = 1.0f / distance[k];
+    prediction += weight * value[k];
+    weight_sum += weight;
+  }
+
+  return prediction / weight_sum;
+}
+
+/*
+ *  compare_predictions() -- compares two phenotypes by the predicted fitness
+ *  stored in their fitness field, in ascending order (best prediction first);
+ *  this function is only used internally by `screen_offspring';
+ *  @arg {const void *} a -- first phenotype to compare;
+ *  @arg {const void *} b -- second phenotype to compare;
+ *  @return {int}         -- comparison result.
+ */
+static int compare_predictions(const void *a, const void *b)
+{
+  struct phenotype *p_a = *(struct phenotype **)a,
+                   *p_b = *(struct phenotype **)b;
+
+  if (p_a->fitness < p_b->fitness)
+    return -1;
+
+  if (p_a->fitness > p_b->fitness)
+    return 1;
+
+  return 0;
+}
+
+/*
+ *  screen_offspring() -- ranks unevaluated candidate offspring by their
+ *  predicted fitness, best first; the first `kept_count' candidates are meant
+ *  to be evaluated and the rest discarded unevaluated, and are counted as
+ *  such; the predictions are left in the candidates' fitness fields, to be
+ *  overwritten by the real evaluation;
+ *  @arg {struct surrogate *} s           -- the surrogate in question; must be
+ *                                           trained (see
+ *                                           `surrogate_is_trained');
+ *  @arg {struct phenotype **} candidates -- the candidates to rank;
+ *  @arg {unsigned int} candidate_count   -- number of candidates;
+ *  @arg {unsigned int} kept_count        -- number of candidates to be kept;
+ *  @return {void}.
+ */
+void screen_offspring(struct surrogate *s, struct phenotype **candidates,
+                      unsigned int candidate_count, unsigned int kept_count)
+{
+  unsigned int i;
+
+  for (i = 0; i < candidate_count; i++) {
+    candidates[i]->fitness = predict_phenotype_fitness(s, candidates[i]);
+  }
+
+  qsort(candidates, candidate_count, sizeof(struct phenotype *),
+        compare_predictions);
+
+  s->screened_count += candidate_count;
+  s->discarded_count += candidate_count - kept_count;
+}
+
+/*
+ *  get_average_rank() -- calculates the rank of a value among others, in
+ *  ascending order, tied values sharing the average of their ranks; this
+ *  function is only used internally by `rate_surrogate_ranking';
+ *  @arg {float *} values       -- the values being ranked;
+ *  @arg {unsigned int} count   -- number of values;
+ *  @arg {unsigned int} index   -- index of the value in question;
+ *  @return {float}             -- the value's rank, starting from zero.
+ */
+static float get_average_rank(float *values, unsigned int count,
+                              unsigned int index)
+{
+  unsigned int i;
+  float less = 0.0f, equal = 0.0f;
+
+  for (i = 0; i < count; i++) {
+    if (values[i] < values[index]) {
+      less += 1.0f;
+    } else if (values[i] == values[index]) {
+      equal += 1.0f;
+    }
+  }
+
+  return less + (equal - 1.0f) / 2.0f;
+}
+
+/*
+ *  rate_surrogate_ranking() -- measures how well the surrogate ranks a batch
+ *  of evaluated offspring, as the Spearman rank correlation between their
+ *  predicted and real fitness, and adds it to the surrogate's running sum;
+ *  this has to be called before the offspring are added to the surrogate;
+ *  batches whose predicted or real fitness values are all tied are ignored;
+ *  @arg {struct surrogate *} s          -- the surrogate in question;
+ *  @arg {struct phenotype **} offspring -- the evaluated offspring;
+ *  @arg {unsigned int} offspring_count  -- number of offspring;
+ *  @return {void}.
+ */
+void rate_surrogate_ranking(struct surrogate *s, struct phenotype **offspring,
+                            unsigned int offspring_count)
+{
+  unsigned int i;
+  float *predicted, *real;
+  float predicted_rank, real_rank, mean = (float)(offspring_count - 1) / 2.0f;
+  float covariance = 0.0f, predicted_variance = 0.0f, real_variance = 0.0f;
+
+  if (offspring_count < 2) {
+    return;
+  }
+
+  predicted = (float*) malloc(sizeof(float) * offspring_count);
+  real = (float*) malloc(sizeof(float) * offspring_count);
+
+  for (i = 0; i < offspring_count; i++) {
+    predicted[i] = predict_phenotype_fitness(s, offspring[i]);
+    real[i] = offspring[i]->fitness;
+  }
+
+  for (i = 0; i < offspring_count; i++) {
+    predicted_rank = get_average_rank(predicted, offspring_count, i) - mean;
+    real_rank = get_average_rank(real, offspring_count, i) - mean;
+
+    covariance += predicted_rank * real_rank;
+    predicted_variance += predicted_rank * predicted_rank;
+    real_variance += real_rank * real_rank;
+  }
+
+  if (predicted_variance > 0.0f && real_variance > 0.0f) {
+    s->rank_correlation_sum += covariance /
+                               sqrtf(predicted_variance * real_variance);
+    s->ranking_count++;
+  }
+
+  free(predicted);
+  free(real);
+}
+
@@ -0,0 +1,75 @@
+
+/*
+ *  surrogate.h ~ speech synthesis toy project
+ *
+ *  Copyright (c) 2016, Vlad Dumitru <dalv.urtimud@gmail.com>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "genetic.h"
+
+/*  number of evaluated phenotypes remembered by the surrogate; older ones are
+    overwritten first */
+#define SURROGATE_ARCHIVE_SIZE 1024
+
+/*  number of remembered phenotypes a prediction is interpolated from */
+#define SURROGATE_NEIGHBOUR_COUNT 5
+
+/*  the surrogate only screens offspring once it remembers this many
+    phenotypes */
+#define SURROGATE_MIN_SAMPLES 32
+
+/*  number of candidate offspring bred for every offspring slot of a
+    generation; only the best predicted candidates fill the slots */
+#define SURROGATE_CANDIDATE_FACTOR 4
+
+struct surrogate {
+  float coefficient[SURROGATE_ARCHIVE_SIZE][PHENOTYPE_CHROMOSOME_COUNT];
+  float log_fitness[SURROGATE_ARCHIVE_SIZE];
+  unsigned int sample_count;          /* number of remembered phenotypes */
+  unsigned int next_sample;           /* archive slot to be written next */
+
+  unsigned long screened_count;       /* candidates ranked by the surrogate */
+  unsigned long discarded_count;      /* candidates discarded unevaluated */
+  float rank_correlation_sum;         /* sum of per-generation Spearman rank
+                                         correlations between predicted and
+                                         real fitness */
+  unsigned int ranking_count;         /* number of correlations summed */
+};
+
+struct surrogate *alloc_surrogate(void);
+
+void free_surrogate(struct surrogate *s);
+
+void add_surrogate_samples(struct surrogate *s, struct phenotype **population,
+                           unsigned int population_count);
+
+int surrogate_is_trained(struct surrogate *s);
+
+float predict_phenotype_fitness(struct surrogate *s, struct phenotype *p);
+
+void screen_offspring(struct surrogate *s, struct phenotype **candidates,
+                      unsigned int candidate_count, unsigned int kept_count);
+
+void rate_surrogate_ranking(struct surrogate *s, struct phenotype **offspring,
+                            unsigned int offspring_count);
+
@@ -26,10 +26,39 @@
 #include <stdio.h>
 #include <math.h>
 
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
 #include "audiobuffer.h"
 #include "genetic.h"
 #include "synth.h"
 
+int flush_denormals = 0;
+
+/*  MXCSR bits making SSE arithmetic flush denormal results to zero (FTZ) and
+    treat denormal operands as zero (DAZ) */
+#define MXCSR_FLUSH_TO_ZERO      0x8000
+#define MXCSR_DENORMALS_ARE_ZERO 0x0040
+
+/*
+ *  apply_denormal_mode() -- when `flush_denormals' is set, switches the
+ *  calling thread's floating point unit to flush denormals to zero, so that
+ *  decaying filter states never take the slow denormal arithmetic path; as
+ *  this is a per-thread setting, it has to be called by every thread running
+ *  filters (i.e. at the top of every parallel region); it only has an effect
+ *  on SSE targets;
+ *  @return {void}.
+ */
+void apply_denormal_mode(void)
+{
+#ifdef __SSE__
+  if (flush_denormals) {
+    _mm_setcsr(_mm_getcsr() | MXCSR_FLUSH_TO_ZERO | MXCSR_DENORMALS_ARE_ZERO);
+  }
+#endif
+}
+
 /*
  *  generate_base_speech_signal() -- creates a buffer of `frame_count' frames,
  *  containing a 25% width pulse wave of `frequency' Hz.
@@ -39,6 +68,24 @@
  */
 struct audio_buffer *generate_base_speech_signal(float frequency,
                                                  unsigned int frame_count)
+{
+  return generate_base_speech_segment(frequency, 0, frame_count);
+}
+
+/*
+ *  generate_base_speech_segment() -- creates a buffer holding `frame_count'
+ *  frames of the signal `generate_base_speech_signal' produces, starting at
+ *  frame `first_frame' of that signal; this keeps the pulse wave's phase, so
+ *  parts of a signal can be synthesized without generating the frames before
+ *  them;
+ *  @arg {float} frequency          -- the frequency of the signal;
+ *  @arg {unsigned int} first_frame -- index of the first frame in the signal;
+ *  @arg {unsigned int} frame_count -- buffer size;
+ *  @return {struct audio_buffer *} -- the filled audio buffer structure.
+ */
+struct audio_buffer *generate_base_speech_segment(float frequency,
+                                                  unsigned int first_frame,
+                                                  unsigned int frame_count)
 {
   unsigned int i;
   unsigned int period = SAMPLE_RATE / frequency;
@@ -46,7 +93,7 @@ struct audio_buffer *generate_base_speech_signal(float frequency,
   struct audio_buffer *buf = alloc_buffer(frame_count);
 
   for (i = 0; i < frame_count; i++) {
-      buf->data[i] = (float)((i % period) < (period / 4)) - 0.5f;
+      buf->data[i] = (float)(((first_frame + i) % period) < (period / 4)) - 0.5f;
   }
 
   return buf;
@@ -159,7 +206,7 @@ void process_filter_from_phenotype(struct phenotype *p,
 
       buf->data[i] = temp;
 
-      for (k = PHENOTYPE_CHROMOSOME_COUNT; k > 0; k--) {
+      for (k = PHENOTYPE_CHROMOSOME_COUNT - 1; k > 0; k--) {
         memory[k] = memory[k - 1];
       }
 
@@ -168,3 +215,56 @@ void process_filter_from_phenotype(struct phenotype *p,
   }
 }
 
+/*
+ *  phenotype_filter_is_stable() -- tells whether the filter built by
+ *  `process_filter_from_phenotype' from a given phenotype is stable, without
+ *  processing any audio; the filter's memory is shifted once per tap, so every
+ *  tap ends up reading the first partial sum of the previous frame, and the
+ *  recurrence reduces to
+ *
+ *      a[n] = c1 * x[n] + c2 * a[n - 1]
+ *      y[n] = c1 * x[n] + (c2 + c3 + c4) * a[n - 1]
+ *
+ *  whose only pole lies at `c2'; the filter is thus stable if and only if
+ *  |c2| < 1;
+ *  @arg {struct phenotype *} p -- the phenotype in question;
+ *  @return {int}               -- non-zero if the filter is stable.
+ */
+int phenotype_filter_is_stable(struct phenotype *p)
+{
+  return fabsf(p->coefficient[2]) < 1.0f;
+}
+
+/*
+ *  phenotype_filter_settling_frames() -- calculates how many frames the filter
+ *  built from a given phenotype needs before the effect of its initial state
+ *  decays below `tolerance'; as its only pole lies at `c2' (see
+ *  `phenotype_filter_is_stable'), the initial state decays as |c2|^n, and one
+ *  more frame is needed for it to reach the output;
+ *  @arg {struct phenotype *} p     -- the phenotype in question;
+ *  @arg {float} tolerance          -- relative weight of the initial state
+ *                                     considered negligible;
+ *  @arg {unsigned int} max_frames  -- upper bound of the result, also returned
+ *                                     for unstable filters;
+ *  @return {unsigned int}          -- number of frames to settle.
+ */
+unsigned int phenotype_filter_settling_frames(struct phenotype *p,
+                                              float tolerance,
+                                              unsigned int max_frames)
+{
+  float pole = fabsf(p->coefficient[2]);
+  float frames;
+
+  if (pole >= 1.0f) {
+    return max_frames;
+  }
+
+  frames = ceilf(logf(tolerance) / logf(pole)) + 1.0f;
+
+  if (frames > (float)max_frames) {
+    return max_frames;
+  }
+
+  return (unsigned int)frames;
+}
+
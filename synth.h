@@ -30,9 +30,15 @@
 
 #define SAMPLE_RATE 44100
 
+extern int flush_denormals;
+
 struct audio_buffer *generate_base_speech_signal(float frequency,
                                                  unsigned int duration);
 
+struct audio_buffer *generate_base_speech_segment(float frequency,
+                                                  unsigned int first_frame,
+                                                  unsigned int frame_count);
+
 void process_formant_filter(struct audio_buffer *buf, float f1, float f2,
                             unsigned int start_frame, unsigned int end_frame);
 
@@ -40,3 +46,12 @@ void process_filter_from_phenotype(struct phenotype *p,
                                    struct audio_buffer *buf,
                                    unsigned int start_frame,
                                    unsigned int end_frame);
+
+void apply_denormal_mode(void);
+
+int phenotype_filter_is_stable(struct phenotype *p);
+
+unsigned int phenotype_filter_settling_frames(struct phenotype *p,
+                                              float tolerance,
+                                              unsigned int max_frames);
+